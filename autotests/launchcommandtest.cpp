@@ -0,0 +1,231 @@
+#include <KConfig>
+#include <KConfigGroup>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <memory>
+
+#include "core/TmuxRunnerAPI.h"
+
+class LaunchCommandTest : public QObject {
+Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testAttachCommand_data();
+    void testAttachCommand();
+    void testCreateCommand_data();
+    void testCreateCommand();
+    void testSessionCommand_data();
+    void testSessionCommand();
+
+    void benchmarkLaunchLatency_data();
+    void benchmarkLaunchLatency();
+
+private:
+    QString tmux(const QStringList &args);
+
+    QTemporaryDir tempDir;
+    std::unique_ptr<KConfig> config;
+    std::unique_ptr<TmuxRunnerAPI> api;
+};
+
+void LaunchCommandTest::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    // The custom profile launches the stub terminal, so that the latency can be measured through the execute methods
+    config.reset(new KConfig(tempDir.filePath("tmuxrunnerrc"), KConfig::SimpleConfig));
+    KConfigGroup customConfig = config->group("Config").group("Custom");
+    customConfig.writeEntry("program", STUB_TERMINAL);
+    customConfig.writeEntry("attach_params", "-e tmux attach-session -t %name");
+    customConfig.writeEntry("new_params", "-e tmux new-session -s %name -c %path");
+    api.reset(new TmuxRunnerAPI(config->group("Config")));
+
+    // Clients must not think that they are nested in the tmux session running the test
+    qunsetenv("TMUX");
+    // All tmux calls of the api, the stub terminal and the test use a private server in the temporary directory
+    qputenv("TMUX_TMPDIR", QFile::encodeName(tempDir.path()));
+    // Stand-in for tmuxinator, which creates the session of the project and attaches to it
+    QVERIFY(QDir(tempDir.path()).mkdir("bin"));
+    QFile tmuxinator(tempDir.filePath("bin/tmuxinator"));
+    QVERIFY(tmuxinator.open(QIODevice::WriteOnly));
+    tmuxinator.write("#!/bin/sh\nexec tmux new-session -A -s \"$1\"\n");
+    tmuxinator.close();
+    QVERIFY(tmuxinator.setPermissions(tmuxinator.permissions() | QFileDevice::ExeOwner));
+    qputenv("PATH", QFile::encodeName(tempDir.filePath("bin")) + ':' + qgetenv("PATH"));
+}
+
+void LaunchCommandTest::cleanupTestCase() {
+    if (!QStandardPaths::findExecutable("tmux").isEmpty()) {
+        tmux({"kill-server"});
+    }
+}
+
+void LaunchCommandTest::testAttachCommand_data() {
+    QTest::addColumn<QString>("program");
+    QTest::addColumn<QString>("expectedProgram");
+    QTest::addColumn<QStringList>("expectedArgs");
+
+    QTest::newRow("konsole") << "konsole" << "konsole" << QStringList{"-e", "tmux", "a", "-t", "foo"};
+    QTest::newRow("yakuake-session") << "yakuake-session" << "yakuake-session"
+                                     << QStringList{"-t", "foo", "-e", "tmux", "attach-session", "-t", "foo"};
+    QTest::newRow("terminator") << "terminator" << "terminator" << QStringList{"-x", "tmux", "a", "-t", "foo"};
+    QTest::newRow("st") << "st" << "st" << QStringList{"tmux", "attach-session", "-t", "foo"};
+    QTest::newRow("custom") << "custom" << STUB_TERMINAL << QStringList{"-e", "tmux", "attach-session", "-t", "foo"};
+}
+
+void LaunchCommandTest::testAttachCommand() {
+    QFETCH(QString, program);
+    QFETCH(QString, expectedProgram);
+    QFETCH(QStringList, expectedArgs);
+
+    const auto command = api->buildAttachCommand(program, "foo");
+    QVERIFY(command.first);
+    QCOMPARE(program, expectedProgram);
+    QCOMPARE(command.second, expectedArgs);
+}
+
+void LaunchCommandTest::testCreateCommand_data() {
+    QTest::addColumn<QString>("program");
+    QTest::addColumn<QString>("action");
+    QTest::addColumn<QString>("target");
+    QTest::addColumn<QString>("expectedProgram");
+    QTest::addColumn<QStringList>("expectedArgs");
+
+    QTest::newRow("konsole") << "konsole" << "new" << "foo" << "konsole"
+                             << QStringList{"-e", "tmux", "new-session", "-s", "foo", "-c", "/tmp"};
+    QTest::newRow("konsole without name") << "konsole" << "new" << "" << "konsole"
+                                          << QStringList{"-e", "tmux", "new-session", "-c", "/tmp"};
+    QTest::newRow("yakuake-session") << "yakuake-session" << "new" << "foo" << "yakuake-session"
+                                     << QStringList{"-t", "foo", "-e", "tmux", "new-session", "-s", "foo", "-c", "/tmp"};
+    QTest::newRow("terminator") << "terminator" << "new" << "foo" << "terminator"
+                                << QStringList{"-x", "tmux", "new-session", "-s", "foo", "-c", "/tmp"};
+    QTest::newRow("st") << "st" << "new" << "foo" << "st"
+                        << QStringList{"tmux", "new-session", "-s", "foo", "-c", "/tmp"};
+    QTest::newRow("custom") << "custom" << "new" << "foo" << STUB_TERMINAL
+                            << QStringList{"-e", "tmux", "new-session", "-s", "foo", "-c", "/tmp"};
+
+    QTest::newRow("tmuxinator konsole") << "konsole" << "tmuxinator" << "foo" << "konsole"
+                                        << QStringList{"-e", "tmuxinator", "foo", "extra"};
+    QTest::newRow("tmuxinator yakuake-session") << "yakuake-session" << "tmuxinator" << "foo" << "yakuake-session"
+                                                << QStringList{"-t", "foo", "-e", "tmuxinator", "foo", "extra"};
+    QTest::newRow("tmuxinator terminator") << "terminator" << "tmuxinator" << "foo" << "terminator"
+                                           << QStringList{"-x", "tmuxinator", "foo", "extra"};
+    QTest::newRow("tmuxinator st") << "st" << "tmuxinator" << "foo" << "st"
+                                   << QStringList{"tmuxinator", "foo", "extra"};
+    QTest::newRow("tmuxinator custom") << "custom" << "tmuxinator" << "foo" << STUB_TERMINAL
+                                       << QStringList{"-e", "tmuxinator", "foo", "extra"};
+}
+
+void LaunchCommandTest::testCreateCommand() {
+    QFETCH(QString, program);
+    QFETCH(QString, action);
+    QFETCH(QString, target);
+    QFETCH(QString, expectedProgram);
+    QFETCH(QStringList, expectedArgs);
+
+    const QMap<QString, QVariant> data = {
+            {"action", action},
+            {"path",   "/tmp"},
+            {"args",   "extra"},
+    };
+    const auto command = api->buildCreateCommand(program, target, data);
+    QVERIFY(command.first);
+    QCOMPARE(program, expectedProgram);
+    QCOMPARE(command.second, expectedArgs);
+}
+
+void LaunchCommandTest::testSessionCommand_data() {
+    QTest::addColumn<QString>("operation");
+    QTest::addColumn<QStringList>("targets");
+    QTest::addColumn<QString>("newName");
+    QTest::addColumn<QStringList>("expectedArgs");
+
+    QTest::newRow("kill") << "kill" << QStringList{"foo", "bar"} << ""
+                          << QStringList{"if-shell", "-F", "-t", "=foo", "1", "kill-session -t =foo", ";",
+                                         "if-shell", "-F", "-t", "=bar", "1", "kill-session -t =bar"};
+    QTest::newRow("detach") << "detach" << QStringList{"foo"} << ""
+                            << QStringList{"if-shell", "-F", "-t", "=foo", "#{session_attached}",
+                                           "detach-client -s =foo"};
+    QTest::newRow("rename") << "rename" << QStringList{"foo"} << "bar"
+                            << QStringList{"rename-session", "-t", "=foo", "bar"};
+    QTest::newRow("rename without new name") << "rename" << QStringList{"foo"} << "" << QStringList();
+    QTest::newRow("unknown operation") << "stop" << QStringList{"foo"} << "" << QStringList();
+    QTest::newRow("no targets") << "kill" << QStringList() << "" << QStringList();
+}
+
+void LaunchCommandTest::testSessionCommand() {
+    QFETCH(QString, operation);
+    QFETCH(QStringList, targets);
+    QFETCH(QString, newName);
+    QFETCH(QStringList, expectedArgs);
+
+    QCOMPARE(api->buildSessionCommand(operation, targets, newName), expectedArgs);
+}
+
+void LaunchCommandTest::benchmarkLaunchLatency_data() {
+    QTest::addColumn<QString>("action");
+    QTest::addColumn<QString>("session");
+
+    QTest::newRow("attach") << "attach" << "latency-attach";
+    QTest::newRow("new") << "new" << "latency-new";
+    QTest::newRow("tmuxinator") << "tmuxinator" << "latency-tmuxinator";
+}
+
+/**
+ * Run the action through the same execute method as TmuxRunner::run, including the checks before launching,
+ * and wait until the client of the stub terminal is attached to the session
+ */
+void LaunchCommandTest::benchmarkLaunchLatency() {
+    QFETCH(QString, action);
+    QFETCH(QString, session);
+    if (QStandardPaths::findExecutable("tmux").isEmpty() || QStandardPaths::findExecutable("script").isEmpty()) {
+        QSKIP("tmux and script are required for measuring the latency");
+    }
+    if (action == "attach") {
+        tmux({"new-session", "-d", "-s", session});
+    }
+    const QString argvFile = tempDir.filePath("argv-" + session);
+    qputenv("TMUXRUNNER_STUB_ARGV", QFile::encodeName(argvFile));
+    const QMap<QString, QVariant> data = {{"action", action}, {"path", QDir::tempPath()}};
+
+    QElapsedTimer timer;
+    timer.start();
+    QString program = "custom";
+    if (action == "attach") {
+        api->executeAttatchCommand(program, session);
+    } else {
+        api->executeCreateCommand(program, session, data);
+    }
+    bool attached = false;
+    while (!attached && timer.elapsed() < 5000) {
+        attached = tmux({"list-clients", "-F", "#{session_name}"}).split('\n').contains(session);
+        if (!attached) QTest::qWait(5);
+    }
+    const qint64 latency = timer.elapsed();
+    QVERIFY2(attached, qPrintable("No client attached to " + session));
+    qInfo() << action << "client of" << session << "attached after" << latency << "ms";
+
+    // The terminal got exactly the generated arguments
+    program = "custom";
+    const auto command = action == "attach" ? api->buildAttachCommand(program, session)
+                                            : api->buildCreateCommand(program, session, data);
+    QFile recordedArgv(argvFile);
+    QVERIFY(recordedArgv.open(QIODevice::ReadOnly));
+    QCOMPARE(QString::fromLocal8Bit(recordedArgv.readAll()).split('\n', Qt::SkipEmptyParts), command.second);
+}
+
+QString LaunchCommandTest::tmux(const QStringList &args) {
+    QProcess process;
+    process.start("tmux", args);
+    process.waitForFinished(2000);
+    return QString::fromLocal8Bit(process.readAllStandardOutput());
+}
+
+QTEST_GUILESS_MAIN(LaunchCommandTest)
+
+#include "launchcommandtest.moc"
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Stand-in for a terminal emulator: records its argv and runs the command after -e,
+# inside a pty so that the tmux client can attach
+printf '%s\n' "$@" > "$TMUXRUNNER_STUB_ARGV"
+while [ $# -gt 0 ] && [ "$1" != -e ]; do shift; done
+[ $# -gt 1 ] || exit 2
+shift
+command=
+for arg in "$@"; do command="$command '$arg'"; done
+# Keep stdin open without writing to it, so that the client stays attached until the server gets killed
+fifo=$(mktemp -u) && mkfifo "$fifo" || exit 2
+script -qec "$command" /dev/null < "$fifo" > /dev/null &
+exec 3> "$fifo"
+rm "$fifo"
+wait $!
+exit 0
@@ -22,7 +22,7 @@ if [[ -z "${QT_PLUGIN_PATH}" || "${QT_PLUGIN_PATH}" != *".local/lib/qt/plugins/"
     export QT_PLUGIN_PATH=~/.local/lib/qt/plugins/:$QT_PLUGIN_PATH
 fi
 
-cmake -DKDE_INSTALL_QTPLUGINDIR="~/.local/lib/qt/plugins" -DKDE_INSTALL_KSERVICES5DIR="~/.local/share/kservices5" -DCMAKE_BUILD_TYPE=Release ..
+cmake -DKDE_INSTALL_QTPLUGINDIR="~/.local/lib/qt/plugins" -DKDE_INSTALL_KSERVICES5DIR="~/.local/share/kservices5" -DKDE_INSTALL_BINDIR="$HOME/.local/bin" -DCMAKE_BUILD_TYPE=Release ..
 
 make -j$(nproc)
 make install
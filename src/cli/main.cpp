@@ -0,0 +1,68 @@
+#include <KSharedConfig>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "core/SessionStateClient.h"
+#include "core/TmuxRunnerAPI.h"
+
+static void printMatches(const QString &query, const SessionState &state) {
+    QTextStream out(stdout);
+    const auto matches = TmuxRunnerAPI::matchSessions(query, state.sessions);
+    for (const auto &match: matches) {
+        out << match.first << '\t' << match.second
+            << (state.attachedSessions.contains(match.first) ? "\tattached" : "") << '\n';
+    }
+    out.flush();
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("tmuxrunner-query"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Print the tmux sessions matching the query like the runner does"));
+    parser.addHelpOption();
+    const QCommandLineOption watchOption(QStringLiteral("watch"),
+                                         QStringLiteral("Keep running and print the matches whenever the sessions change"));
+    const QCommandLineOption localOption(QStringLiteral("local"),
+                                         QStringLiteral("Ask tmux directly instead of tmuxrunnerd"));
+    parser.addOption(watchOption);
+    parser.addOption(localOption);
+    parser.addPositionalArgument(QStringLiteral("query"), QStringLiteral("Start of the session name"));
+    parser.process(app);
+    const QString query = parser.positionalArguments().join(' ');
+
+    SessionState state;
+    if (parser.isSet(localOption)) {
+        TmuxRunnerAPI api(KSharedConfig::openConfig(TmuxRunnerAPI::configFileLocation())->group("Config"));
+        state.sessions = api.fetchTmuxSessions();
+        printMatches(query, state);
+        return 0;
+    }
+    if (!parser.isSet(watchOption)) {
+        if (!SessionStateClient::fetchSnapshot(state, 1000)) {
+            QTextStream(stderr) << "tmuxrunnerd is not running, use --local to ask tmux directly\n";
+            return 1;
+        }
+        printMatches(query, state);
+        return 0;
+    }
+
+    SessionStateSubscriber subscriber;
+    bool stateReceived = false;
+    QObject::connect(&subscriber, &SessionStateSubscriber::stateChanged, [&]() {
+        stateReceived = true;
+        const SessionState state = subscriber.state();
+        QTextStream(stdout) << "# revision " << state.revision << '\n';
+        printMatches(query, state);
+    });
+    QObject::connect(&subscriber, &SessionStateSubscriber::disconnected, [&]() {
+        if (!stateReceived) {
+            QTextStream(stderr) << "tmuxrunnerd is not running\n";
+        }
+        app.exit(stateReceived ? 0 : 1);
+    });
+    subscriber.subscribe();
+    return app.exec();
+}
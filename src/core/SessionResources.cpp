@@ -0,0 +1,131 @@
+#include "SessionResources.h"
+#include "SessionStateProtocol.h"
+
+#include <KFormat>
+#include <QProcess>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool SessionResources::update(const SessionState *state) {
+    if (lastScan.isValid() && lastScan.elapsed() < minScanInterval) {
+        return false;
+    }
+    const bool recentSample = lastScan.isValid() && lastScan.elapsed() <= maxCpuSampleAge;
+    const double elapsedSeconds = recentSample ? lastScan.elapsed() / 1000.0 : 0;
+    lastScan.start();
+
+    QHash<QString, bool> attached;
+    QHash<QString, QList<int>> panePids;
+    if (state) {
+        panePids = state->panePids;
+        for (const auto &session: state->attachedSessions) {
+            attached.insert(session, true);
+        }
+    } else {
+        panePids = fetchPanePids(attached);
+    }
+    const auto processes = scanProcesses();
+
+    // Build the process trees once, each pane is the root of one tree
+    QHash<int, QList<int>> children;
+    for (auto it = processes.constBegin(); it != processes.constEnd(); ++it) {
+        children[it.value().ppid].append(it.key());
+    }
+
+    static const long pageSize = sysconf(_SC_PAGESIZE);
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    QHash<int, qint64> cpuTicks;
+    sessions.clear();
+    for (auto it = panePids.constBegin(); it != panePids.constEnd(); ++it) {
+        SessionUsage usage;
+        usage.attached = attached.value(it.key());
+        qint64 deltaTicks = 0;
+        QList<int> pending = it.value();
+        while (!pending.isEmpty()) {
+            const int pid = pending.takeLast();
+            const auto process = processes.find(pid);
+            if (process == processes.constEnd() || cpuTicks.contains(pid)) continue;
+            usage.rssBytes += process->rssPages * pageSize;
+            cpuTicks.insert(pid, process->cpuTicks);
+            // Processes which were not there in the last scan count from their start
+            deltaTicks += process->cpuTicks - previousCpuTicks.value(pid, recentSample ? 0 : process->cpuTicks);
+            pending.append(children.value(pid));
+        }
+        if (recentSample && elapsedSeconds > 0) {
+            usage.cpuPercent = qMax<qint64>(deltaTicks, 0) * 100.0 / ticksPerSecond / elapsedSeconds;
+            usage.cpuKnown = true;
+        }
+        sessions.insert(it.key(), usage);
+    }
+    previousCpuTicks = cpuTicks;
+    return true;
+}
+
+QString SessionResources::formatUsage(const SessionUsage &usage) {
+    const QString memory = KFormat().formatByteSize(usage.rssBytes, 1);
+    if (!usage.cpuKnown) {
+        return memory;
+    }
+    return QStringLiteral("%1, %2% CPU").arg(memory, QString::number(usage.cpuPercent, 'f', 0));
+}
+
+QHash<QString, QList<int>> SessionResources::fetchPanePids(QHash<QString, bool> &attached) {
+    QHash<QString, QList<int>> panePids;
+    QProcess process;
+    process.start(QStringLiteral("tmux"), {QStringLiteral("list-panes"), QStringLiteral("-a"), QStringLiteral("-F"),
+                                           QStringLiteral("#{session_name}:#{session_attached}:#{pane_pid}")});
+    process.waitForFinished(1000);
+    while (process.canReadLine()) {
+        // Tmux does not allow colons in session names
+        const QStringList parts = QString(process.readLine()).trimmed().split(QLatin1Char(':'));
+        if (parts.size() != 3) continue;
+        attached.insert(parts.at(0), parts.at(1).toInt() > 0);
+        panePids[parts.at(0)].append(parts.at(2).toInt());
+    }
+    return panePids;
+}
+
+QHash<int, SessionResources::ProcessStat> SessionResources::scanProcesses() {
+    QHash<int, ProcessStat> processes;
+    DIR *procDir = opendir("/proc");
+    if (!procDir) return processes;
+    char path[64];
+    char buffer[1024];
+    while (const dirent *entry = readdir(procDir)) {
+        char *end;
+        const long pid = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || pid <= 0) continue;
+        snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) continue;
+        const ssize_t size = read(fd, buffer, sizeof(buffer) - 1);
+        close(fd);
+        if (size <= 0) continue;
+        buffer[size] = '\0';
+
+        // The command name can contain spaces and parentheses, the fields start after the last ')'
+        const char *fields = strrchr(buffer, ')');
+        if (!fields) continue;
+        // Fields after the name: state ppid ... utime(14) stime(15) ... rss(24), see man 5 proc
+        long long values[22] = {};
+        char *cursor = const_cast<char *>(fields) + 2;
+        for (int field = 3; field <= 24 && *cursor; ++field) {
+            while (*cursor == ' ') ++cursor;
+            values[field - 3] = strtoll(cursor, &cursor, 10);
+            // The state is a character, skip it
+            if (field == 3) while (*cursor && *cursor != ' ') ++cursor;
+        }
+        ProcessStat stat;
+        stat.ppid = static_cast<int>(values[4 - 3]);
+        stat.cpuTicks = values[14 - 3] + values[15 - 3];
+        stat.rssPages = values[24 - 3];
+        processes.insert(static_cast<int>(pid), stat);
+    }
+    closedir(procDir);
+    return processes;
+}
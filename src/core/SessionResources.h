@@ -0,0 +1,57 @@
+#ifndef TMUXRUNNER_SESSIONRESOURCES_H
+#define TMUXRUNNER_SESSIONRESOURCES_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+struct SessionState;
+
+struct SessionUsage {
+    qint64 rssBytes = 0;
+    // CPU usage since the previous scan, 100 means one fully used core
+    double cpuPercent = 0;
+    // False if there was no scan shortly before, an average over a long time says nothing about the current usage
+    bool cpuKnown = false;
+    bool attached = false;
+};
+
+/**
+ * Aggregates the memory and CPU usage of all processes running in the panes of a tmux session.
+ * The pane pids are fetched using one tmux call and the process trees are read in a single pass over /proc
+ */
+class SessionResources {
+public:
+    /**
+     * Rescan the sessions, if the last scan is older than the minimum interval.
+     * Otherwise the cached values are kept, returns true if a scan was done.
+     * If a state from tmuxrunnerd is given, its pane pids are used instead of asking tmux
+     */
+    bool update(const SessionState *state = nullptr);
+
+    inline QHash<QString, SessionUsage> usage() const
+    {
+        return sessions;
+    }
+
+    static QString formatUsage(const SessionUsage &usage);
+
+private:
+    struct ProcessStat {
+        int ppid = 0;
+        qint64 cpuTicks = 0;
+        qint64 rssPages = 0;
+    };
+
+    static QHash<QString, QList<int>> fetchPanePids(QHash<QString, bool> &attached);
+    static QHash<int, ProcessStat> scanProcesses();
+
+    static const int minScanInterval = 2000;
+    // The previous scan must not be older than this for calculating the CPU usage
+    static const int maxCpuSampleAge = 10000;
+    QElapsedTimer lastScan;
+    QHash<int, qint64> previousCpuTicks;
+    QHash<QString, SessionUsage> sessions;
+};
+
+#endif //TMUXRUNNER_SESSIONRESOURCES_H
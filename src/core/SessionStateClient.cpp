@@ -0,0 +1,81 @@
+#include "SessionStateClient.h"
+
+#include <QElapsedTimer>
+
+bool SessionStateClient::fetchSnapshot(SessionState &state, int timeout) {
+    QLocalSocket socket;
+    socket.connectToServer(SessionStateProtocol::socketPath());
+    if (!socket.waitForConnected(timeout)) {
+        return false;
+    }
+    socket.write(SessionStateProtocol::request(SessionStateProtocol::GetSnapshot));
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray buffer;
+    QByteArray payload;
+    bool invalid;
+    while (!SessionStateProtocol::takeMessage(buffer, payload, invalid)) {
+        const int remaining = timeout - int(timer.elapsed());
+        if (invalid || remaining <= 0 || !socket.waitForReadyRead(remaining)) {
+            return false;
+        }
+        buffer.append(socket.readAll());
+    }
+    quint8 type;
+    return parseReply(payload, type, state) && type == SessionStateProtocol::Snapshot;
+}
+
+bool SessionStateClient::parseReply(const QByteArray &payload, quint8 &type, SessionState &state) {
+    QDataStream stream(payload);
+    stream.setVersion(SessionStateProtocol::streamVersion);
+    quint8 version;
+    stream >> version >> type;
+    if (version != SessionStateProtocol::version) {
+        return false;
+    }
+    stream >> state;
+    return stream.status() == QDataStream::Ok;
+}
+
+SessionStateSubscriber::SessionStateSubscriber(QObject *parent) : QObject(parent) {
+    connect(&socket, &QLocalSocket::connected, this, [this]() {
+        socket.write(SessionStateProtocol::request(SessionStateProtocol::Subscribe));
+    });
+    connect(&socket, &QLocalSocket::readyRead, this, &SessionStateSubscriber::readMessages);
+    connect(&socket, &QLocalSocket::disconnected, this, [this]() {
+        stateReceived = false;
+        buffer.clear();
+        Q_EMIT disconnected();
+    });
+    connect(&socket, &QLocalSocket::errorOccurred, this, [this]() {
+        if (socket.state() == QLocalSocket::UnconnectedState) {
+            stateReceived = false;
+            Q_EMIT disconnected();
+        }
+    });
+}
+
+void SessionStateSubscriber::subscribe() {
+    if (socket.state() == QLocalSocket::UnconnectedState) {
+        socket.connectToServer(SessionStateProtocol::socketPath());
+    }
+}
+
+void SessionStateSubscriber::readMessages() {
+    buffer.append(socket.readAll());
+    QByteArray payload;
+    bool invalid;
+    while (SessionStateProtocol::takeMessage(buffer, payload, invalid)) {
+        quint8 type;
+        SessionState state;
+        if (SessionStateClient::parseReply(payload, type, state)) {
+            currentState = state;
+            stateReceived = true;
+            Q_EMIT stateChanged();
+        }
+    }
+    if (invalid) {
+        socket.abort();
+    }
+}
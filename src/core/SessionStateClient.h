@@ -0,0 +1,63 @@
+#ifndef TMUXRUNNER_SESSIONSTATECLIENT_H
+#define TMUXRUNNER_SESSIONSTATECLIENT_H
+
+#include <QLocalSocket>
+#include <QObject>
+
+#include "SessionStateProtocol.h"
+
+/**
+ * Client side of the tmuxrunnerd socket API
+ */
+class SessionStateClient {
+public:
+    /**
+     * Blocking request of the current state, returns false if the daemon is not running or does not answer in time
+     */
+    static bool fetchSnapshot(SessionState &state, int timeout = 250);
+
+    /**
+     * Parse a message payload sent by the daemon, returns false for unknown versions or invalid data
+     */
+    static bool parseReply(const QByteArray &payload, quint8 &type, SessionState &state);
+};
+
+/**
+ * Stays subscribed to tmuxrunnerd and keeps the latest state, so that reading it costs no round trip
+ */
+class SessionStateSubscriber : public QObject {
+Q_OBJECT
+
+public:
+    explicit SessionStateSubscriber(QObject *parent = nullptr);
+
+    /**
+     * Connect to the daemon without blocking, does nothing if already connected
+     */
+    void subscribe();
+
+    inline bool hasState() const
+    {
+        return stateReceived && socket.state() == QLocalSocket::ConnectedState;
+    }
+
+    inline SessionState state() const
+    {
+        return currentState;
+    }
+
+Q_SIGNALS:
+    void stateChanged();
+    // Emitted if the connection fails or gets closed
+    void disconnected();
+
+private:
+    void readMessages();
+
+    QLocalSocket socket;
+    QByteArray buffer;
+    SessionState currentState;
+    bool stateReceived = false;
+};
+
+#endif //TMUXRUNNER_SESSIONSTATECLIENT_H
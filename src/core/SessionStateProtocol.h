@@ -0,0 +1,123 @@
+#ifndef TMUXRUNNER_SESSIONSTATEPROTOCOL_H
+#define TMUXRUNNER_SESSIONSTATEPROTOCOL_H
+
+#include <QDataStream>
+#include <QHash>
+#include <QList>
+#include <QStandardPaths>
+#include <QString>
+#include <QStringList>
+
+/**
+ * State of the tmux server(s) which is shared by tmuxrunnerd with the runner and tmuxrunner-query
+ */
+struct SessionState {
+    quint64 revision = 0;
+    QStringList sessions;
+    QStringList attachedSessions;
+    // Pids of the panes for each session
+    QHash<QString, QList<int>> panePids;
+    QStringList tmuxinatorConfigs;
+
+    inline bool sameContent(const SessionState &other) const
+    {
+        return sessions == other.sessions && attachedSessions == other.attachedSessions
+               && panePids == other.panePids && tmuxinatorConfigs == other.tmuxinatorConfigs;
+    }
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const SessionState &state)
+{
+    return stream << state.revision << state.sessions << state.attachedSessions << state.panePids
+                  << state.tmuxinatorConfigs;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, SessionState &state)
+{
+    return stream >> state.revision >> state.sessions >> state.attachedSessions >> state.panePids
+                  >> state.tmuxinatorConfigs;
+}
+
+/**
+ * Each message is a quint32 length followed by a QDataStream payload that starts with the protocol version
+ * and the message type
+ */
+namespace SessionStateProtocol {
+    const quint8 version = 1;
+    const QDataStream::Version streamVersion = QDataStream::Qt_5_12;
+    // Larger frames are treated as corrupt, the connection should be closed
+    const quint32 maxFrameSize = 16 * 1024 * 1024;
+
+    enum Request : quint8 {
+        // Answered with one Snapshot message
+        GetSnapshot = 1,
+        // Answered with a Snapshot message and a Changed message whenever the state changes
+        Subscribe = 2,
+    };
+
+    enum Reply : quint8 {
+        Snapshot = 1,
+        Changed = 2,
+    };
+
+    inline QString socketPath()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/tmuxrunnerd.socket");
+    }
+
+    inline QByteArray frame(const QByteArray &payload)
+    {
+        QByteArray message;
+        QDataStream stream(&message, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        stream << quint32(payload.size());
+        message.append(payload);
+        return message;
+    }
+
+    /**
+     * Takes one complete message from the buffer, returns false if it does not contain one yet.
+     * If the frame is larger than maxFrameSize, invalid is set and the connection should be closed
+     */
+    inline bool takeMessage(QByteArray &buffer, QByteArray &payload, bool &invalid)
+    {
+        invalid = false;
+        if (buffer.size() < int(sizeof(quint32))) {
+            return false;
+        }
+        QDataStream stream(buffer);
+        stream.setVersion(streamVersion);
+        quint32 size;
+        stream >> size;
+        if (size > maxFrameSize) {
+            invalid = true;
+            return false;
+        }
+        if (qint64(buffer.size()) < qint64(sizeof(quint32)) + qint64(size)) {
+            return false;
+        }
+        payload = buffer.mid(sizeof(quint32), size);
+        buffer.remove(0, sizeof(quint32) + size);
+        return true;
+    }
+
+    inline QByteArray request(Request type)
+    {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        stream << version << quint8(type);
+        return frame(payload);
+    }
+
+    inline QByteArray reply(Reply type, const SessionState &state)
+    {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        stream << version << quint8(type) << state;
+        return frame(payload);
+    }
+}
+
+#endif //TMUXRUNNER_SESSIONSTATEPROTOCOL_H
@@ -6,18 +6,36 @@
 #include <KShell>
 #include <QProcess>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
 
 TmuxRunnerAPI::TmuxRunnerAPI(const KConfigGroup &config) : config(config) {
+    reloadShortcuts();
+}
+
+void TmuxRunnerAPI::reloadShortcuts() {
+    shortcuts = config.group("Shortcuts").entryMap();
 }
 
 QString TmuxRunnerAPI::filterPath(QString path) {
     if (path.isEmpty()) {
         return QDir::homePath();
     }
-    const auto shortcutConfig = config.group("Shortcuts");
-    const auto keyList = shortcutConfig.keyList();
-    for (const auto &key: keyList) {
-        path.replace(key, shortcutConfig.readEntry(key));
+    for (auto it = shortcuts.constBegin(); it != shortcuts.constEnd(); ++it) {
+        path.replace(it.key(), it.value());
     }
     if (path.startsWith('~')) {
         path.replace('~', QDir::homePath());
@@ -41,7 +59,36 @@ QStringList TmuxRunnerAPI::fetchTmuxSessions() {
     return tmuxSessions;
 }
 
+bool TmuxRunnerAPI::sessionExists(const QString &name) {
+    QProcess process;
+    process.start(fetchProgram, {"has-session", "-t", "=" + name});
+    process.waitForFinished(1000);
+    return process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+QList<QPair<QString, float>> TmuxRunnerAPI::matchSessions(const QString &queryName, const QStringList &sessions) {
+    QList<QPair<QString, float>> matches;
+    for (const auto &session: sessions) {
+        if (session.startsWith(queryName)) {
+            matches.append({session, (float) queryName.length() / (float) session.length()});
+        }
+    }
+    return matches;
+}
+
 void TmuxRunnerAPI::executeAttatchCommand(QString &program, const QString &target) {
+    // The exit code of tmux is hidden by the terminal, check the session before launching it
+    if (!sessionExists(target)) {
+        showErrorNotification("The session " + target + " does not exist anymore!");
+        return;
+    }
+    const auto command = buildAttachCommand(program, target);
+    if (command.first) {
+        launch(program, command.second);
+    }
+}
+
+QPair<bool, QStringList> TmuxRunnerAPI::buildAttachCommand(QString &program, const QString &target) {
     QStringList args;
     if (program == "yakuake-session") {
         args.append({"-t", target, "-e", "tmux", "attach-session", "-t", target});
@@ -60,20 +107,43 @@ void TmuxRunnerAPI::executeAttatchCommand(QString &program, const QString &targe
             args.append(splitPair.second);
         } else {
             showErrorNotification("The command line arguments from the custom config are invalid!");
-            return;
+            return {false, args};
         }
     } else {
         args.append({"-e", "tmux", "a", "-t", target});
     }
-    QProcess::startDetached(program, args);
+    return {true, args};
 }
 
 void TmuxRunnerAPI::executeCreateCommand(QString &program,
                                          const QString &target,
                                          const QMap<QString, QVariant> &data) {
+    // The exit code of tmux is hidden by the terminal, check for the usual errors before launching it.
+    // Tmuxinator attaches to an existing session instead of failing
+    if (data.value("action") != "tmuxinator") {
+        const QString path = filterPath(data.value("path").toString());
+        if (!QFileInfo(path).isDir()) {
+            showErrorNotification("The directory " + path + " does not exist!");
+            return;
+        }
+        if (!target.isEmpty() && sessionExists(target)) {
+            showErrorNotification("A session with the name " + target + " already exists!");
+            return;
+        }
+    }
+    const auto command = buildCreateCommand(program, target, data);
+    if (command.first) {
+        launch(program, command.second);
+    }
+}
+
+QPair<bool, QStringList> TmuxRunnerAPI::buildCreateCommand(QString &program,
+                                                           const QString &target,
+                                                           const QMap<QString, QVariant> &data) {
     QStringList args;
     const QString path = filterPath(data.value("path").toString());
-    if (program == "yakuake") {
+    const bool isCustom = program == "custom";
+    if (program == "yakuake-session") {
         if (data.value("action") != "tmuxinator")
             args.append({"-t", target, "-e", "tmux", "new-session", "-s", target});
         else args.append({"-t", target, "-e", "tmuxinator", target});
@@ -95,19 +165,21 @@ void TmuxRunnerAPI::executeCreateCommand(QString &program,
             args.append(splitPair.second);
         } else {
             showErrorNotification("The command line arguments from the custom config are invalid!");
-            return;
+            return {false, args};
         }
     } else {
         args.append({"-e", "tmux", "new-session", "-s", target});
     }
-    // Add path option
-    if (program != "custom") {
+    // Add path option, the custom program gets the path using the %path macro
+    if (!isCustom) {
         args.append({"-c", path});
     }
 
     // Remove everything after tmux and replace (workaround for custom)
     if (data.value("action") == "tmuxinator") {
-        const int idx = args.indexOf("tmux");
+        int idx = args.indexOf("tmux");
+        if (idx == -1) idx = args.indexOf("tmuxinator");
+        if (idx == -1) idx = 0;
         while (args.size() > idx) {
             args.removeLast();
         }
@@ -127,17 +199,68 @@ void TmuxRunnerAPI::executeCreateCommand(QString &program,
     }
     args.removeAll(QString());
 
-    QProcess::startDetached(program, args);
+    return {true, args};
+}
+
+void TmuxRunnerAPI::executeSessionCommand(const QString &operation,
+                                          const QStringList &targets,
+                                          const QString &newName) {
+    const QStringList args = buildSessionCommand(operation, targets, newName);
+    if (!args.isEmpty()) {
+        // Tmux exits with 1 if a guarded kill/detach target was closed in the meantime, which is no error here.
+        // A failed rename (name taken in the meantime) is reported
+        launch(fetchProgram, args, operation == "rename");
+    }
+}
+
+QStringList TmuxRunnerAPI::buildSessionCommand(const QString &operation,
+                                               const QStringList &targets,
+                                               const QString &newName) {
+    QStringList args;
+    for (const auto &target: targets) {
+        // Prefix with = so that tmux does not fall back to prefix/pattern matching of the name
+        const QString exactTarget = "=" + target;
+        QStringList command;
+        // A failing command aborts the rest of the chain, but errors of the if-shell target or the nested
+        // command do not. The session list might be outdated, so sessions could have been closed already
+        if (operation == "kill") {
+            command = {"if-shell", "-F", "-t", exactTarget, "1",
+                       "kill-session -t " + KShell::quoteArg(exactTarget)};
+        } else if (operation == "detach") {
+            // Only detach if there are clients, detaching a session without clients is an error
+            command = {"if-shell", "-F", "-t", exactTarget, "#{session_attached}",
+                       "detach-client -s " + KShell::quoteArg(exactTarget)};
+        } else if (operation == "rename" && !newName.isEmpty()) {
+            command = {"rename-session", "-t", exactTarget, newName};
+        }
+        if (command.isEmpty()) {
+            continue;
+        }
+        if (!args.isEmpty()) {
+            args.append(";");
+        }
+        args.append(command);
+    }
+    return args;
 }
 
 QStringList TmuxRunnerAPI::fetchTmuxinatorConfigs() {
+    bool installed;
+    const QStringList tmuxinatorConfigs = discoverTmuxinatorConfigs(&installed);
+    if (!installed) {
+        // Disable tmuxinator until the user installs and enables it
+        config.writeEntry("enable_tmuxinator", false);
+    }
+    return tmuxinatorConfigs;
+}
+
+QStringList TmuxRunnerAPI::discoverTmuxinatorConfigs(bool *installed) {
     QStringList tmuxinatorConfigs;
     QProcess isTmuxinatorInstalledProcess;
     isTmuxinatorInstalledProcess.start("whereis", QStringList{"-b", "tmuxinator"});
     isTmuxinatorInstalledProcess.waitForFinished();
-    if (QString(isTmuxinatorInstalledProcess.readAll()) == "tmuxinator:\n") {
-        // Disable tmuxinator until the user installs and enables it
-        config.writeEntry("enable_tmuxinator", false);
+    *installed = QString(isTmuxinatorInstalledProcess.readAll()) != "tmuxinator:\n";
+    if (!*installed) {
         return tmuxinatorConfigs;
     }
     // Fetch the available configurations
@@ -185,6 +308,104 @@ QPair<bool, QStringList> TmuxRunnerAPI::splitArguments(const QString &argument)
     return {splitArgsError == KShell::Errors::NoError, args};
 }
 
+bool TmuxRunnerAPI::launch(const QString &program, const QStringList &args, bool reportExit) {
+    QList<QByteArray> encodedArgs{QFile::encodeName(program)};
+    for (const auto &arg: args) {
+        encodedArgs.append(arg.toLocal8Bit());
+    }
+    QVector<char *> argv;
+    for (auto &arg: encodedArgs) {
+        argv.append(arg.data());
+    }
+    argv.append(nullptr);
+
+    // Same as QProcess::startDetached: own session, a clean signal mask and SIGPIPE reset to the default
+    // handler in case the host ignores it, but without the double fork
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signalMask;
+    sigemptyset(&signalMask);
+    posix_spawnattr_setsigmask(&attr, &signalMask);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaultSignals);
+#ifdef POSIX_SPAWN_SETSID
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+#else
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+#endif
+
+    // glibc and musl report exec failures (missing binary, no permission) as return value
+    pid_t pid;
+    const int spawnError = posix_spawnp(&pid, argv.first(), nullptr, &attr, argv.data(), environ);
+    posix_spawnattr_destroy(&attr);
+    if (spawnError != 0) {
+        showErrorNotification(QStringLiteral("Could not start %1: %2").arg(program, QString::fromLocal8Bit(strerror(spawnError))));
+        return false;
+    }
+
+    watchChild(pid, program + ' ' + args.join(' '), reportExit);
+    return true;
+}
+
+void TmuxRunnerAPI::watchChild(pid_t pid, const QString &commandLine, bool reportExit) {
+    // Reap the child so that no zombie is left behind and report if it fails right after the launch.
+    // The exit is waited for in the event loop of the calling thread, open terminals do not block any thread
+    QElapsedTimer timer;
+    timer.start();
+    const auto reap = [pid, commandLine, reportExit, timer]() {
+        int status = 0;
+        pid_t result;
+        while ((result = waitpid(pid, &status, WNOHANG)) == -1 && errno == EINTR);
+        if (result == 0) {
+            return false;
+        }
+        if (result == pid && reportExit && timer.elapsed() <= earlyExitTimeout) {
+            QString reason;
+            if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+                reason = QStringLiteral("exited with code %1").arg(WEXITSTATUS(status));
+            } else if (WIFSIGNALED(status)) {
+                reason = QStringLiteral("was killed by signal %1").arg(WTERMSIG(status));
+            }
+            if (!reason.isEmpty()) {
+                showErrorNotification(commandLine + QStringLiteral(" ") + reason);
+            }
+        }
+        return true;
+    };
+
+#ifdef SYS_pidfd_open
+    // The pidfd becomes readable once the child exits
+    const int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidfd != -1) {
+        auto *notifier = new QSocketNotifier(pidfd, QSocketNotifier::Read);
+        QObject::connect(notifier, &QSocketNotifier::activated, notifier, [notifier, pidfd, reap]() {
+            if (reap()) {
+                notifier->setEnabled(false);
+                notifier->deleteLater();
+                close(pidfd);
+            }
+        });
+        return;
+    }
+#endif
+    // Kernels without pidfd (before 5.3): check often while the exit counts as a failed launch, rarely afterwards
+    auto *pollTimer = new QTimer();
+    pollTimer->setInterval(100);
+    QObject::connect(pollTimer, &QTimer::timeout, pollTimer, [pollTimer, timer, reap]() {
+        if (timer.elapsed() > earlyExitTimeout) {
+            pollTimer->setInterval(5000);
+        }
+        if (reap()) {
+            pollTimer->stop();
+            pollTimer->deleteLater();
+        }
+    });
+    pollTimer->start();
+}
+
 void TmuxRunnerAPI::showErrorNotification(const QString &msg) {
     KNotification::event(KNotification::Error,
                          QStringLiteral("Tmux Runner"),
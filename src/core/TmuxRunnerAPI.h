@@ -6,6 +6,7 @@
 #include <QStandardPaths>
 #include <QString>
 #include <QStringList>
+#include <sys/types.h>
 
 class TmuxRunnerAPI {
 public:
@@ -13,19 +14,61 @@ public:
 
     QString filterPath(QString path);
 
+    // Update the cached shortcuts after the config has been reparsed
+    void reloadShortcuts();
+
     QStringList fetchTmuxSessions();
 
+    bool sessionExists(const QString &name);
+
     QStringList fetchTmuxinatorConfigs();
 
+    /**
+     * Same as fetchTmuxinatorConfigs, but does not disable tmuxinator in the config if it is not installed
+     */
+    static QStringList discoverTmuxinatorConfigs(bool *installed);
+
+    /**
+     * Sessions which start with the query name and their relevance, shared by the runner and tmuxrunner-query
+     */
+    static QList<QPair<QString, float>> matchSessions(const QString &queryName, const QStringList &sessions);
+
     void executeAttatchCommand(QString &program, const QString &target);
 
     void executeCreateCommand(QString &program, const QString &target, const QMap<QString, QVariant> &data);
 
+    /**
+     * Build the arguments for attaching to/creating a session without launching anything.
+     * The program gets resolved in place (custom => configured program), the bool is false
+     * if the arguments are invalid and nothing should be launched
+     */
+    QPair<bool, QStringList> buildAttachCommand(QString &program, const QString &target);
+
+    QPair<bool, QStringList> buildCreateCommand(QString &program, const QString &target,
+                                                const QMap<QString, QVariant> &data);
+
+    /**
+     * Apply the operation (kill, detach or rename) to all target sessions using a single ;-chained tmux command
+     */
+    void executeSessionCommand(const QString &operation, const QStringList &targets,
+                               const QString &newName = QString());
+
+    QStringList buildSessionCommand(const QString &operation, const QStringList &targets,
+                                    const QString &newName = QString());
+
     QString parseQueryFlags(QString &term, QString &openIn);
 
     QPair<bool, QStringList> splitArguments(const QString &argument);
 
-    void showErrorNotification(const QString &msg);
+    /**
+     * Start the program detached using posix_spawn. Launch errors (missing program) and a non-zero exit
+     * of the program shortly after the launch are shown as notifications. Errors of tmux inside of a terminal
+     * are not visible here, the execute methods check for those before launching.
+     * The exit is watched in the event loop of the calling thread, reportExit = false only reports launch errors
+     */
+    bool launch(const QString &program, const QStringList &args, bool reportExit = true);
+
+    static void showErrorNotification(const QString &msg);
 
     inline static QString configFileLocation()
     {
@@ -33,8 +76,13 @@ public:
     }
 
 private:
+    static void watchChild(pid_t pid, const QString &commandLine, bool reportExit);
+
+    // Time in ms in which an exit of a launched program is considered to be a failed launch
+    static const int earlyExitTimeout = 3000;
     const QLatin1Char lineSeparator = QLatin1Char(':');
     KConfigGroup config;
+    QMap<QString, QString> shortcuts;
     const QString fetchProgram = QStringLiteral("tmux");
     const QStringList fetchArgs = {QStringLiteral("ls")};
     const QMap<QString, QString> flags = {
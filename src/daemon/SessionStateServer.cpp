@@ -0,0 +1,286 @@
+#include "SessionStateServer.h"
+#include "core/TmuxRunnerAPI.h"
+
+#include <KConfigGroup>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <unistd.h>
+
+SessionStateServer::SessionStateServer(QObject *parent) : QObject(parent) {
+    config = KSharedConfig::openConfig(TmuxRunnerAPI::configFileLocation());
+    configFilePath = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/krunnerplugins/tmuxrunnerrc";
+    // Same location as tmux uses for the default socket
+    QString tmuxTmpDir = qEnvironmentVariable("TMUX_TMPDIR");
+    if (tmuxTmpDir.isEmpty()) tmuxTmpDir = QStringLiteral("/tmp");
+    tmuxSocketDir = tmuxTmpDir + "/tmux-" + QString::number(getuid());
+
+    refreshTimer.setSingleShot(true);
+    connect(&refreshTimer, &QTimer::timeout, this, &SessionStateServer::refresh);
+    connect(&refreshWatcher, &QFutureWatcher<SessionState>::finished, this, [this]() {
+        publish(refreshWatcher.result());
+        if (refreshPending) {
+            refresh();
+        }
+    });
+    controlClient.setStandardErrorFile(QProcess::nullDevice());
+    connect(&controlClient, &QProcess::started, this, [this]() {
+        // Attaching and detaching clients is not notified, tmux checks the subscription every second instead
+        controlClient.write("refresh-client -B 'attached::#{S:#{session_name}=#{session_attached},}'\n");
+    });
+    connect(&controlClient, &QProcess::readyReadStandardOutput, this, &SessionStateServer::handleNotifications);
+    // The attached session was closed, the server exited or the client could not be started
+    connect(&controlClient, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &SessionStateServer::scheduleRefresh);
+    connect(&controlClient, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) scheduleRefresh();
+    });
+    connect(&pathWatcher, &QFileSystemWatcher::fileChanged, this, &SessionStateServer::handlePathChange);
+    connect(&pathWatcher, &QFileSystemWatcher::directoryChanged, this, &SessionStateServer::handlePathChange);
+    watchPaths();
+    connect(&server, &QLocalServer::newConnection, this, &SessionStateServer::handleConnection);
+}
+
+bool SessionStateServer::listen() {
+    const QString path = SessionStateProtocol::socketPath();
+    if (!server.listen(path)) {
+        // The socket file might be left over from a crashed daemon, remove it if nobody answers
+        QLocalSocket probe;
+        probe.connectToServer(path);
+        if (probe.waitForConnected(250)) {
+            return false;
+        }
+        QLocalServer::removeServer(path);
+        if (!server.listen(path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SessionStateServer::handleConnection() {
+    while (QLocalSocket *socket = server.nextPendingConnection()) {
+        ++connectionCount;
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            QByteArray &buffer = buffers[socket];
+            buffer.append(socket->readAll());
+            QByteArray payload;
+            bool invalid;
+            while (SessionStateProtocol::takeMessage(buffer, payload, invalid)) {
+                handleRequest(socket, payload);
+            }
+            if (invalid) {
+                socket->abort();
+            }
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            buffers.remove(socket);
+            subscribers.removeOne(socket);
+            pendingSnapshots.removeOne(socket);
+            if (--connectionCount == 0) {
+                // Nobody needs the state, stop watching tmux. The control client exits when its input gets closed.
+                // The cached state gets outdated, the next request has to wait for a refresh
+                if (controlClient.state() != QProcess::NotRunning) {
+                    controlClient.closeWriteChannel();
+                }
+                refreshTimer.stop();
+                stateReady = false;
+            }
+            socket->deleteLater();
+        });
+        // The first refresh also starts watching tmux
+        if (!stateReady && !refreshWatcher.isRunning()) {
+            refresh();
+        }
+    }
+}
+
+void SessionStateServer::handleRequest(QLocalSocket *socket, const QByteArray &payload) {
+    QDataStream stream(payload);
+    stream.setVersion(SessionStateProtocol::streamVersion);
+    quint8 version, type;
+    stream >> version >> type;
+    if (version != SessionStateProtocol::version) {
+        socket->disconnectFromServer();
+        return;
+    }
+    if (type == SessionStateProtocol::Subscribe && !subscribers.contains(socket)) {
+        subscribers.append(socket);
+    }
+    // Never ask tmux while handling a request, the state gets refreshed in the background
+    if (stateReady) {
+        socket->write(SessionStateProtocol::reply(SessionStateProtocol::Snapshot, state));
+    } else if (!pendingSnapshots.contains(socket)) {
+        pendingSnapshots.append(socket);
+    }
+}
+
+void SessionStateServer::handleNotifications() {
+    while (controlClient.canReadLine()) {
+        const QByteArray line = controlClient.readLine();
+        // Replies to commands are framed by %begin and %end, every other line starting with % is a notification
+        if (line.startsWith('%') && !line.startsWith("%begin") && !line.startsWith("%end")
+            && !line.startsWith("%error")) {
+            scheduleRefresh();
+        }
+    }
+}
+
+void SessionStateServer::handlePathChange(const QString &path) {
+    // Replaced files and created directories have to be added again
+    watchPaths();
+    if (path == tmuxSocketDir || path == QFileInfo(tmuxSocketDir).path()) {
+        // A new server creates its socket, while the control client runs it reports everything else
+        if (connectionCount > 0 && controlClient.state() == QProcess::NotRunning
+            && QFileInfo::exists(tmuxSocketDir + "/default")) {
+            scheduleRefresh();
+        }
+    } else {
+        // The config file or the tmuxinator projects changed
+        tmuxinatorOutdated = true;
+        if (connectionCount > 0) {
+            scheduleRefresh();
+        }
+    }
+}
+
+void SessionStateServer::watchPaths() {
+    QStringList paths = {configFilePath,
+                         QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/tmuxinator",
+                         QDir::homePath() + "/.tmuxinator"};
+    if (!qEnvironmentVariableIsEmpty("TMUXINATOR_CONFIG")) {
+        paths.append(qEnvironmentVariable("TMUXINATOR_CONFIG"));
+    }
+    // Watch the parent until tmux created the socket directory
+    const QString socketParentDir = QFileInfo(tmuxSocketDir).path();
+    if (QFileInfo::exists(tmuxSocketDir)) {
+        paths.append(tmuxSocketDir);
+        pathWatcher.removePath(socketParentDir);
+    } else {
+        paths.append(socketParentDir);
+    }
+    for (const auto &path: qAsConst(paths)) {
+        if (QFileInfo::exists(path) && !pathWatcher.files().contains(path) && !pathWatcher.directories().contains(path)) {
+            pathWatcher.addPath(path);
+        }
+    }
+}
+
+void SessionStateServer::scheduleRefresh() {
+    if (!refreshTimer.isActive() || refreshTimer.remainingTime() > notificationDelay) {
+        refreshTimer.start(notificationDelay);
+    }
+}
+
+void SessionStateServer::refresh() {
+    if (connectionCount == 0) {
+        return;
+    }
+    if (refreshWatcher.isRunning()) {
+        refreshPending = true;
+        return;
+    }
+    refreshPending = false;
+    // Not part of the first refresh, so that waiting requests are answered quickly
+    fetchTmuxinatorPending = stateReady && tmuxinatorOutdated;
+    bool fetchTmuxinator = false;
+    if (fetchTmuxinatorPending) {
+        tmuxinatorOutdated = false;
+        fetchTmuxinator = tmuxinatorEnabled();
+    }
+    refreshWatcher.setFuture(QtConcurrent::run(&SessionStateServer::fetchState, fetchTmuxinator,
+                                               controlClient.processId()));
+}
+
+bool SessionStateServer::tmuxinatorEnabled() {
+    // Same as in the runner: enabled by default, but only used if tmuxinator is installed.
+    // The config is read here, the worker thread must not touch it
+    config->reparseConfiguration();
+    return config->group("Config").readEntry("enable_tmuxinator", true)
+           && !QStandardPaths::findExecutable(QStringLiteral("tmuxinator")).isEmpty();
+}
+
+SessionState SessionStateServer::fetchState(bool fetchTmuxinator, qint64 controlClientPid) {
+    SessionState newState;
+    // One tmux call for everything, the lines are told apart by their prefix. Tmux does not allow colons in session names
+    QProcess process;
+    process.start(QStringLiteral("tmux"), {QStringLiteral("ls"), QStringLiteral("-F"), QStringLiteral("S:#{session_name}"),
+                                           QStringLiteral(";"), QStringLiteral("list-panes"), QStringLiteral("-a"),
+                                           QStringLiteral("-F"), QStringLiteral("P:#{session_name}:#{pane_pid}"),
+                                           QStringLiteral(";"), QStringLiteral("list-clients"),
+                                           QStringLiteral("-F"), QStringLiteral("C:#{client_pid}:#{session_name}")});
+    process.waitForFinished(1000);
+    while (process.canReadLine()) {
+        const QStringList parts = QString::fromLocal8Bit(process.readLine()).trimmed().split(QLatin1Char(':'));
+        if (parts.first() == QLatin1String("S") && parts.size() == 2) {
+            newState.sessions.append(parts.at(1));
+        } else if (parts.first() == QLatin1String("P") && parts.size() == 3) {
+            newState.panePids[parts.at(1)].append(parts.at(2).toInt());
+        } else if (parts.first() == QLatin1String("C") && parts.size() == 3) {
+            // The control client of the daemon does not count as attached
+            if (parts.at(1).toLongLong() != controlClientPid && !newState.attachedSessions.contains(parts.at(2))) {
+                newState.attachedSessions.append(parts.at(2));
+            }
+        }
+    }
+    newState.attachedSessions.sort();
+    if (fetchTmuxinator) {
+        bool installed;
+        newState.tmuxinatorConfigs = TmuxRunnerAPI::discoverTmuxinatorConfigs(&installed);
+    }
+    return newState;
+}
+
+void SessionStateServer::publish(SessionState newState) {
+    // Everybody disconnected during the refresh
+    if (connectionCount == 0) {
+        return;
+    }
+    // Keep the previous tmuxinator configs if they were not fetched this time
+    if (!fetchTmuxinatorPending) {
+        newState.tmuxinatorConfigs = state.tmuxinatorConfigs;
+    }
+    const bool changed = !stateReady || !newState.sameContent(state);
+    if (changed) {
+        newState.revision = state.revision + 1;
+        state = newState;
+    }
+    stateReady = true;
+
+    const QByteArray snapshot = SessionStateProtocol::reply(SessionStateProtocol::Snapshot, state);
+    for (QLocalSocket *socket: qAsConst(pendingSnapshots)) {
+        socket->write(snapshot);
+    }
+    if (changed) {
+        const QByteArray message = SessionStateProtocol::reply(SessionStateProtocol::Changed, state);
+        for (QLocalSocket *subscriber: qAsConst(subscribers)) {
+            if (!pendingSnapshots.contains(subscriber)) {
+                subscriber->write(message);
+            }
+        }
+    }
+    pendingSnapshots.clear();
+
+    watchTmux();
+    if (tmuxinatorOutdated) {
+        scheduleRefresh();
+    }
+}
+
+void SessionStateServer::watchTmux() {
+    // Without sessions there is nothing to attach to, a new server is noticed by its socket
+    if (connectionCount == 0 || controlClient.state() != QProcess::NotRunning || state.sessions.isEmpty()) {
+        return;
+    }
+    if (controlClientStart.isValid() && controlClientStart.elapsed() < controlClientRetryInterval) {
+        refreshTimer.start(controlClientRetryInterval - int(controlClientStart.elapsed()));
+        return;
+    }
+    controlClientStart.start();
+    // Read-only client which gets no pane output and does not influence the window sizes
+    controlClient.start(QStringLiteral("tmux"), {QStringLiteral("-C"), QStringLiteral("attach-session"),
+                                                 QStringLiteral("-f"), QStringLiteral("no-output,ignore-size,read-only")});
+}
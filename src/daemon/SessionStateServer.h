@@ -0,0 +1,72 @@
+#ifndef TMUXRUNNER_SESSIONSTATESERVER_H
+#define TMUXRUNNER_SESSIONSTATESERVER_H
+
+#include <KSharedConfig>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QLocalServer>
+#include <QProcess>
+#include <QTimer>
+
+#include "core/SessionStateProtocol.h"
+
+class QLocalSocket;
+
+/**
+ * Owns the connection to tmux and serves the session state to all frontends over a Unix socket.
+ * While clients are connected, a tmux control mode client reports the changes of the sessions, which
+ * trigger a refresh in a worker thread. Requests are always answered from the cached state
+ */
+class SessionStateServer : public QObject {
+Q_OBJECT
+
+public:
+    explicit SessionStateServer(QObject *parent = nullptr);
+
+    bool listen();
+
+private:
+    void handleConnection();
+    void handleRequest(QLocalSocket *socket, const QByteArray &payload);
+    void handleNotifications();
+    void handlePathChange(const QString &path);
+    void scheduleRefresh();
+    void refresh();
+    void publish(SessionState newState);
+    void watchTmux();
+    void watchPaths();
+    bool tmuxinatorEnabled();
+    static SessionState fetchState(bool fetchTmuxinator, qint64 controlClientPid);
+
+    QLocalServer server;
+    // Attached to a session in control mode, prints a notification whenever something changes
+    QProcess controlClient;
+    QElapsedTimer controlClientStart;
+    // Collects bursts of notifications into one refresh, also used for retrying to start the control client
+    QTimer refreshTimer;
+    // Socket directory of tmux, the config file and the tmuxinator projects
+    QFileSystemWatcher pathWatcher;
+    QFutureWatcher<SessionState> refreshWatcher;
+    KSharedConfig::Ptr config;
+    QString configFilePath;
+    QString tmuxSocketDir;
+    QHash<QLocalSocket *, QByteArray> buffers;
+    QList<QLocalSocket *> subscribers;
+    // Snapshot requests received before the first refresh finished
+    QList<QLocalSocket *> pendingSnapshots;
+    SessionState state;
+    bool stateReady = false;
+    bool refreshPending = false;
+    bool tmuxinatorOutdated = true;
+    bool fetchTmuxinatorPending = false;
+    int connectionCount = 0;
+
+    static const int notificationDelay = 50;
+    // Minimum time between two starts of the control client, tmux before 3.2 does not support
+    // the flags of the control client. In that case the state gets refreshed in this interval
+    static const int controlClientRetryInterval = 2000;
+};
+
+#endif //TMUXRUNNER_SESSIONSTATESERVER_H
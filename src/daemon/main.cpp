@@ -0,0 +1,17 @@
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "SessionStateServer.h"
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("tmuxrunnerd"));
+
+    SessionStateServer server;
+    if (!server.listen()) {
+        QTextStream(stderr) << "tmuxrunnerd is already running or the socket "
+                            << SessionStateProtocol::socketPath() << " can not be created\n";
+        return 1;
+    }
+    return app.exec();
+}
@@ -6,6 +6,7 @@
 #include <QtCore>
 #include <QAction>
 #include <KSharedConfig>
+#include <QtConcurrent>
 
 
 TmuxRunner::TmuxRunner(QObject *parent, const KPluginMetaData &data, const QVariantList &args)
@@ -21,29 +22,114 @@ TmuxRunner::TmuxRunner(QObject *parent, const KPluginMetaData &data, const QVari
         configFile.open(QIODevice::WriteOnly);
         configFile.close();
     }
-    // Add file watcher for config
-    watcher.addPath(configFolder + "tmuxrunnerrc");
-    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &TmuxRunner::reloadPluginConfiguration);
+    // Add file watcher for config, a single save of the config dialog writes the file multiple times
+    configFilePath = configFolder + "tmuxrunnerrc";
+    watcher.addPath(configFilePath);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &TmuxRunner::scheduleConfigReload);
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(250);
+    connect(&reloadTimer, &QTimer::timeout, this, [this]() {
+        reloadPluginConfiguration(configFilePath);
+    });
     connect(this, &TmuxRunner::prepare, this, [this]() {
-        tmuxSessions = api->fetchTmuxSessions();
+        // Prefer the state pushed by tmuxrunnerd, this costs no tmux call or round trip.
+        // Ask tmux directly if the daemon is not running
+        const bool daemonState = daemonSubscriber.hasState();
+        const SessionState state = daemonSubscriber.state();
+        if (daemonState) {
+            tmuxSessions = state.sessions;
+            if (enableTmuxinator && !state.tmuxinatorConfigs.isEmpty()) {
+                tmuxinatorConfigs = state.tmuxinatorConfigs;
+            }
+        } else {
+            tmuxSessions = api->fetchTmuxSessions();
+            if (!daemonStartRequested) {
+                daemonStartRequested = true;
+                QProcess::startDetached(QStringLiteral("tmuxrunnerd"), QStringList());
+            }
+            // Connects in the background, the state is used starting with the next query
+            daemonSubscriber.subscribe();
+        }
+        queryActive = true;
+        updateSessionUsage(daemonState ? &state : nullptr);
+    });
+    daemonSubscriber.subscribe();
+    connect(this, &TmuxRunner::teardown, this, [this]() {
+        queryActive = false;
     });
+    connect(&sessionUsageWatcher, &QFutureWatcher<bool>::finished, this, &TmuxRunner::publishSessionUsage);
+    killAction = new QAction(QIcon::fromTheme("process-stop"), "Kill session", this);
+    detachAction = new QAction(QIcon::fromTheme("view-close"), "Detach all clients", this);
 
     config = KSharedConfig::openConfig(TmuxRunnerAPI::configFileLocation())->group("Config");
 
     api.reset(new TmuxRunnerAPI(config));
 
+    QList<Plasma::RunnerSyntax> syntaxes;
+    syntaxes.append(Plasma::RunnerSyntax("tmux", "List available tmux sessions"));
+    syntaxes.append(Plasma::RunnerSyntax("tmux :q:", "Filter sessions or create new session for the given term"));
+    syntaxes.append(Plasma::RunnerSyntax("tmux top", "List sessions sorted by their memory usage"));
+    syntaxes.append(Plasma::RunnerSyntax("tmux kill :q:", "Kill all sessions matching the pattern, like ci-*"));
+    syntaxes.append(Plasma::RunnerSyntax("tmux detach :q:", "Detach the clients of all sessions matching the pattern"));
+    syntaxes.append(Plasma::RunnerSyntax("tmux rename :q:", "Rename a session, the query is the session and the new name"));
+    setSyntaxes(syntaxes);
+
     reloadPluginConfiguration();
 }
 
+TmuxRunner::~TmuxRunner() {
+    // The scan uses the members of the runner
+    sessionUsageWatcher.waitForFinished();
+}
+
+void TmuxRunner::scheduleConfigReload(const QString &path) {
+    // If the file gets edited with a text editor, it often gets replaced by the edited version
+    // https://stackoverflow.com/a/30076119/9342842
+    if (QFile::exists(path)) {
+        watcher.addPath(path);
+    }
+    // Restart the timer, so that multiple writes in a short time cause only one reload
+    reloadTimer.start();
+}
+
 /**
- * Call method whenever the config file changes, the normal reloadConfiguration method gets called to often
+ * Call method whenever the config file changes, the normal reloadConfiguration method gets called to often.
+ * Only the parts whose config entries changed since the last call get rebuilt
  */
 void TmuxRunner::reloadPluginConfiguration(const QString &path) {
     // Method was triggered using file watcher => get new state from file
     if (!path.isEmpty()) config.config()->reparseConfiguration();
-    enableTmuxinator = config.readEntry("enable_tmuxinator", true);
+    const bool initialLoad = path.isEmpty();
+    const auto configEntries = config.entryMap();
+    const auto shortcutEntries = config.group("Shortcuts").entryMap();
+    const auto entryChanged = [&](const QString &key) {
+        return initialLoad || configEntries.value(key) != previousConfigEntries.value(key);
+    };
+
     enableFlags = config.readEntry("enable_flags", true);
     defaultProgram = config.readEntry("program", "konsole");
+    heavySessionBytes = config.readEntry("heavy_session_mb", 1024) * 1024LL * 1024LL;
+    // The custom terminal profile is read when launching, the shortcuts are cached by the api
+    if (!initialLoad && shortcutEntries != previousShortcutEntries) {
+        api->reloadShortcuts();
+    }
+    if (entryChanged("action_program")) {
+        reloadActionList();
+    }
+    if (entryChanged("enable_tmuxinator")) {
+        enableTmuxinator = config.readEntry("enable_tmuxinator", true);
+        if (enableTmuxinator) {
+            tmuxinatorConfigs = api->fetchTmuxinatorConfigs();
+            enableTmuxinator = !tmuxinatorConfigs.isEmpty();
+        }
+    }
+
+    // Read the entries again, the tmuxinator discovery might have disabled it
+    previousConfigEntries = config.entryMap();
+    previousShortcutEntries = shortcutEntries;
+}
+
+void TmuxRunner::reloadActionList() {
     const QString actionChoiceText = config.readEntry("action_program", "None");
     const QString actionChoice = actionChoiceText.toLower();
     if(actionChoice == QLatin1String("none")){
@@ -65,23 +151,6 @@ void TmuxRunner::reloadPluginConfiguration(const QString &path) {
         qDeleteAll(actionList);
         actionList = {new QAction(actionIcon, "Open session in " + actionChoiceText, this)};
     }
-
-    // If the file gets edited with a text editor, it often gets replaced by the edited version
-    // https://stackoverflow.com/a/30076119/9342842
-    if (!path.isEmpty()) {
-        if (QFile::exists(path)) {
-            watcher.addPath(path);
-        }
-    }
-    if (enableTmuxinator) {
-        tmuxinatorConfigs = api->fetchTmuxinatorConfigs();
-        enableTmuxinator = !tmuxinatorConfigs.isEmpty();
-    }
-
-    QList<Plasma::RunnerSyntax> syntaxes;
-    syntaxes.append(Plasma::RunnerSyntax("tmux", "List available tmux sessions"));
-    syntaxes.append(Plasma::RunnerSyntax("tmux :q:", "Filter sessions or create new session for the given term"));
-    setSyntaxes(syntaxes);
 }
 
 void TmuxRunner::match(Plasma::RunnerContext &context) {
@@ -110,6 +179,35 @@ void TmuxRunner::match(Plasma::RunnerContext &context) {
         context.addMatches(addTmuxinatorMatches(term, openIn, program, attached));
     }
 
+    // Kill/detach all sessions matching the pattern. Like rename and top, the query falls through
+    // to the normal matches if nothing matches, so that sessions can still be named like the keywords
+    const static QRegularExpression batchQueryRegex(R"(^(kill|detach) +(\S+)$)");
+    const QRegularExpressionMatch batchMatch = batchQueryRegex.match(term);
+    if (batchMatch.hasMatch()) {
+        const auto batchMatches = addTmuxBatchMatches(batchMatch.captured(1), batchMatch.captured(2));
+        if (!batchMatches.isEmpty()) {
+            context.addMatches(batchMatches);
+            return;
+        }
+    }
+
+    // Rename a session, the new name is required before showing the matches
+    const static QRegularExpression renameQueryRegex(R"(^rename(?: +(\S+)(?: +(\S+))?)?$)");
+    const QRegularExpressionMatch renameMatch = renameQueryRegex.match(term);
+    if (renameMatch.hasMatch()) {
+        const auto renameMatches = addTmuxRenameMatches(renameMatch.captured(1), renameMatch.captured(2));
+        if (!renameMatches.isEmpty()) {
+            context.addMatches(renameMatches);
+            return;
+        }
+    }
+
+    // Sessions sorted by memory usage
+    if (term == topQuery && !tmuxSessions.isEmpty()) {
+        context.addMatches(addTmuxTopMatches(openIn, program));
+        return;
+    }
+
     // Attach to session options
     context.addMatches(addTmuxAttachMatches(term, openIn, program, attached, &exactMatch));
 
@@ -131,13 +229,57 @@ void TmuxRunner::run(const Plasma::RunnerContext &context, const Plasma::QueryMa
     }
     const QString target = data.value("target").toString();
 
-    if (data.value("action") == "attach") {
+    if (match.selectedAction() == killAction) {
+        api->executeSessionCommand("kill", {target});
+    } else if (match.selectedAction() == detachAction) {
+        api->executeSessionCommand("detach", {target});
+    } else if (data.value("action") == "batch") {
+        api->executeSessionCommand(data.value("operation").toString(), data.value("targets").toStringList(),
+                                   data.value("new_name").toString());
+    } else if (data.value("action") == "attach") {
         api->executeAttatchCommand(program, target);
     } else {
         api->executeCreateCommand(program, target, data);
     }
 }
 
+void TmuxRunner::updateSessionUsage(const SessionState *state) {
+    // Reading /proc (and asking tmux without the daemon) takes a while with many processes,
+    // scan in a worker thread so that KRunner is not blocked. The matches show the usage once it is available
+    if (sessionUsageWatcher.isRunning()) {
+        return;
+    }
+    const bool daemonState = state != nullptr;
+    const SessionState stateCopy = daemonState ? *state : SessionState();
+    sessionUsageWatcher.setFuture(QtConcurrent::run([this, daemonState, stateCopy]() {
+        return sessionResources.update(daemonState ? &stateCopy : nullptr);
+    }));
+}
+
+void TmuxRunner::publishSessionUsage() {
+    // The scan is throttled, reopening KRunner quickly reuses the previous values
+    if (!sessionUsageWatcher.result()) {
+        return;
+    }
+    const auto usage = sessionResources.usage();
+    bool cpuKnown = true;
+    for (const auto &entry: usage) {
+        cpuKnown = cpuKnown && entry.cpuKnown;
+    }
+    {
+        QMutexLocker locker(&sessionUsageMutex);
+        sessionUsage = usage;
+    }
+    // Without a recent scan the CPU usage is unknown, take a second sample while KRunner is still open
+    if (!cpuKnown) {
+        QTimer::singleShot(cpuSampleDelay, this, [this]() {
+            if (!queryActive) return;
+            const SessionState state = daemonSubscriber.state();
+            updateSessionUsage(daemonSubscriber.hasState() ? &state : nullptr);
+        });
+    }
+}
+
 Plasma::QueryMatch TmuxRunner::createMatch(const QString &text, const QMap<QString, QVariant> &data, float relevance) {
     Plasma::QueryMatch match(this);
     match.setIcon(icon);
@@ -148,6 +290,32 @@ Plasma::QueryMatch TmuxRunner::createMatch(const QString &text, const QMap<QStri
     return match;
 }
 
+Plasma::QueryMatch TmuxRunner::createAttachMatch(const QString &session, const QString &openIn,
+                                                 const QString &program, float relevance) {
+    QString text = "Attach to " + session + openIn;
+    QHash<QString, SessionUsage> currentUsage;
+    {
+        // The usage gets updated from the main thread when a scan finishes
+        QMutexLocker locker(&sessionUsageMutex);
+        currentUsage = sessionUsage;
+    }
+    const auto usage = currentUsage.constFind(session);
+    if (usage != currentUsage.constEnd()) {
+        // Detached sessions that use a lot of memory but (almost) no CPU are likely forgotten,
+        // without a recent CPU sample a session is never considered to be idle
+        const bool idleHeavy = !usage->attached && usage->rssBytes >= heavySessionBytes
+                               && usage->cpuKnown && usage->cpuPercent < 1;
+        text.append("  (" + SessionResources::formatUsage(*usage) + (idleHeavy ? ", idle)" : ")"));
+    }
+    Plasma::QueryMatch match = createMatch(text,
+                                           {{"action",  "attach"},
+                                            {"program", program},
+                                            {"target",  session}},
+                                           relevance);
+    match.setActions(QList<QAction *>(actionList) << killAction << detachAction);
+    return match;
+}
+
 QList<Plasma::QueryMatch>
 TmuxRunner::addTmuxinatorMatches(QString &term, const QString &openIn, const QString &program,
                                  QStringList &attached) {
@@ -190,18 +358,67 @@ TmuxRunner::addTmuxAttachMatches(QString &term, const QString &openIn, const QSt
                                  QStringList &attached, bool *exactMatch) {
     QList<Plasma::QueryMatch> matches;
     const auto queryName = term.contains(' ') ? term.split(' ').first() : term;
-    for (const auto &session: qAsConst(tmuxSessions)) {
-        if (session.startsWith(queryName)) {
-            if (session == queryName) *exactMatch = true;
-            if (attached.contains(session)) continue;
-            matches.append(
-                    createMatch("Attach to " + session + openIn,
-                                {{"action",  "attach"},
-                                 {"program", program},
-                                 {"target",  session}},
-                                (float) queryName.length() / (float) session.length())
-            );
-        }
+    const auto sessionMatches = TmuxRunnerAPI::matchSessions(queryName, tmuxSessions);
+    for (const auto &sessionMatch: sessionMatches) {
+        const QString &session = sessionMatch.first;
+        if (session == queryName) *exactMatch = true;
+        if (attached.contains(session)) continue;
+        matches.append(createAttachMatch(session, openIn, program, sessionMatch.second));
+    }
+    return matches;
+}
+
+QList<Plasma::QueryMatch> TmuxRunner::addTmuxBatchMatches(const QString &operation, const QString &pattern) {
+    QList<Plasma::QueryMatch> matches;
+    const QRegularExpression patternRegex(QRegularExpression::wildcardToRegularExpression(pattern));
+    const QStringList targets = tmuxSessions.filter(patternRegex);
+    if (targets.isEmpty()) {
+        return matches;
+    }
+    const QString text = (operation == "kill" ? "Kill " : "Detach clients of ")
+                         + QString::number(targets.size()) + (targets.size() == 1 ? " session" : " sessions")
+                         + " matching " + pattern + ": " + targets.mid(0, 5).join(", ")
+                         + (targets.size() > 5 ? ", ..." : "");
+    matches.append(createMatch(text,
+                               {{"action",    "batch"},
+                                {"operation", operation},
+                                {"targets",   targets}}, 1));
+    matches.last().setActions({});
+    return matches;
+}
+
+QList<Plasma::QueryMatch> TmuxRunner::addTmuxRenameMatches(const QString &queryName, const QString &newName) {
+    QList<Plasma::QueryMatch> matches;
+    const static QRegularExpression nameRegex(R"(^[\w-]+$)");
+    if (!nameRegex.match(newName).hasMatch() || tmuxSessions.contains(newName)) {
+        return matches;
+    }
+    const auto sessionMatches = TmuxRunnerAPI::matchSessions(queryName, tmuxSessions);
+    for (const auto &sessionMatch: sessionMatches) {
+        matches.append(createMatch("Rename " + sessionMatch.first + " to " + newName,
+                                   {{"action",    "batch"},
+                                    {"operation", "rename"},
+                                    {"targets",   QStringList{sessionMatch.first}},
+                                    {"new_name",  newName}}, sessionMatch.second));
+        matches.last().setActions({});
+    }
+    return matches;
+}
+
+QList<Plasma::QueryMatch> TmuxRunner::addTmuxTopMatches(const QString &openIn, const QString &program) {
+    QList<Plasma::QueryMatch> matches;
+    QStringList sessions = tmuxSessions;
+    QHash<QString, SessionUsage> currentUsage;
+    {
+        QMutexLocker locker(&sessionUsageMutex);
+        currentUsage = sessionUsage;
+    }
+    std::sort(sessions.begin(), sessions.end(), [&currentUsage](const QString &a, const QString &b) {
+        return currentUsage.value(a).rssBytes > currentUsage.value(b).rssBytes;
+    });
+    // Relevance decreases with the position, so that KRunner keeps the order
+    for (int i = 0; i < sessions.size(); ++i) {
+        matches.append(createAttachMatch(sessions.at(i), openIn, program, 1 - (float) i / (float) (sessions.size() + 1)));
     }
     return matches;
 }
@@ -5,16 +5,36 @@
 #include <QtCore>
 #include <KSharedConfig>
 #include "core/TmuxRunnerAPI.h"
+#include "core/SessionResources.h"
+#include "core/SessionStateClient.h"
 
 class TmuxRunner : public Plasma::AbstractRunner {
 Q_OBJECT
 
 public:
     TmuxRunner(QObject *parent, const KPluginMetaData &data, const QVariantList &args);
+    ~TmuxRunner() override;
 
     QFileSystemWatcher watcher;
-    QList<QString> tmuxSessions;
+    QString configFilePath;
+    QTimer reloadTimer;
+    // Config state of the last reload, used to rebuild only the changed parts
+    QMap<QString, QString> previousConfigEntries;
+    QMap<QString, QString> previousShortcutEntries;
+    QStringList tmuxSessions;
     QList<QString> tmuxinatorConfigs;
+    // Guarded by the mutex, because the scan can finish while matching
+    QHash<QString, SessionUsage> sessionUsage;
+    QMutex sessionUsageMutex;
+    // Only used by the scan running in the worker thread
+    SessionResources sessionResources;
+    QFutureWatcher<bool> sessionUsageWatcher;
+    bool queryActive = false;
+    // Delay of the second sample if the CPU usage is unknown, must not be below the scan interval
+    const int cpuSampleDelay = 2100;
+    // Try to start tmuxrunnerd only once, if it is not installed the runner falls back to asking tmux
+    bool daemonStartRequested = false;
+    SessionStateSubscriber daemonSubscriber;
     KConfigGroup config;
 
     bool enableTmuxinator, enableFlags;
@@ -22,29 +42,43 @@ public:
     QString defaultProgram;
     QString actionProgram;
     QList<QAction *> actionList;
+    // Session management actions, shown next to the attach action
+    QAction *killAction;
+    QAction *detachAction;
+    qint64 heavySessionBytes;
 
     // Reusable variables
     const QLatin1String triggerWord{"tmux"};
     const QRegularExpression triggerWordRegex{"tmux *"};
     const QIcon icon = QIcon::fromTheme("utilities-terminal");
     const QLatin1String tmuxinatorQuery{"inator"};
+    const QLatin1String topQuery{"top"};
 
     std::unique_ptr<TmuxRunnerAPI> api;
 
 protected Q_SLOTS:
+    void scheduleConfigReload(const QString &path);
     void reloadPluginConfiguration(const QString &path = QString());
+    void reloadActionList();
+    void updateSessionUsage(const SessionState *state);
+    void publishSessionUsage();
 
 public:
     void match(Plasma::RunnerContext &context) override;
     void run(const Plasma::RunnerContext &context, const Plasma::QueryMatch &match) override;
 
     Plasma::QueryMatch createMatch(const QString &text, const QMap<QString, QVariant> &data, float relevance);
+    Plasma::QueryMatch createAttachMatch(const QString &session, const QString &openIn, const QString &program,
+                                         float relevance);
     QList<Plasma::QueryMatch> addTmuxAttachMatches(QString &term, const QString &openIn, const QString &program,
                                                    QStringList &attached, bool *exactMatch);
     QList<Plasma::QueryMatch> addTmuxNewSessionMatches(QString &term, const QString &openIn, const QString &program,
                                                        bool tmuxinator);
     QList<Plasma::QueryMatch> addTmuxinatorMatches(QString &term, const QString &openIn, const QString &program,
                                                    QStringList &attached);
+    QList<Plasma::QueryMatch> addTmuxTopMatches(const QString &openIn, const QString &program);
+    QList<Plasma::QueryMatch> addTmuxBatchMatches(const QString &operation, const QString &pattern);
+    QList<Plasma::QueryMatch> addTmuxRenameMatches(const QString &queryName, const QString &newName);
 
 };
 